@@ -7,6 +7,7 @@
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 #include "tmecab.hpp"
 #include "Mmap.hpp"
@@ -19,21 +20,32 @@ namespace TMeCab {
 		uint32_t invoke:       1 = 0;
 		bool isKindOf(CharInfo c) const noexcept { return type & c.type; }
 	};
+	// char.bin has CharInfo of U+0000..U+FFFE only and is looked up directly for them.
+	// The rest of Unicode is stored as 256-character blocks shared by identical ranges.
 	class CharProperty {
 		private:
+			static constexpr uint32_t MaxCode    = 0x110000;
+			static constexpr uint32_t BmpSize    = 0xffff; // entries of char.bin
+			static constexpr uint32_t BlockBits  = 8;
+			static constexpr uint32_t BlockSize  = 1 << BlockBits;
+			static constexpr uint32_t FirstBlock = BmpSize >> BlockBits; // block of U+FFFF
 			Mmap<char>               mmap_;
 			std::vector<std::string> clist_;
-			const CharInfo          *cinfo_;
+			const CharInfo          *cinfo_;  // U+0000..U+FFFE
+			std::vector<uint16_t>    index_;  // (code >> BlockBits) - FirstBlock -> block
+			std::vector<CharInfo>    blocks_; // BlockSize * number of blocks
 		public:
 			explicit CharProperty() {}
 			~CharProperty() {}
-			bool open(const std::string &filename) {
+			// extended: characters out of char.bin borrow the class of a similar one (see representative()),
+			// otherwise they are U+0000 as in mecab.
+			bool open(const std::string &filename, const bool extended) {
 				if (!mmap_.open(filename))
 					return false;
 				const char *ptr = mmap_.begin();
 
 				const size_t csize = read32u(&ptr);
-				const size_t fsize = sizeof(uint32_t) + (csize * 32) + sizeof(CharInfo) * 0xffff;
+				const size_t fsize = sizeof(uint32_t) + (csize * 32) + sizeof(CharInfo) * BmpSize;
 				if (fsize != mmap_.size()) {
 					std::cerr << "invalid file size: " << filename << std::endl;
 					return false;
@@ -43,9 +55,28 @@ namespace TMeCab {
 					ptr += 32;
 				}
 				cinfo_ = reinterpret_cast<const CharInfo *>(ptr);
+
+				index_.clear();
+				blocks_.clear();
+				std::unordered_map<std::string, uint16_t> seen;
+				CharInfo block[BlockSize];
+				for (uint32_t hi = FirstBlock; hi < (MaxCode >> BlockBits); ++hi) {
+					for (uint32_t lo = 0; lo < BlockSize; ++lo) {
+						const auto c = (hi << BlockBits) | lo;
+						block[lo] = cinfo_[c < BmpSize ? c : extended ? representative(c) : 0];
+					}
+					const std::string key(reinterpret_cast<const char *>(block), sizeof(block));
+					const auto [it, added] = seen.try_emplace(key, static_cast<uint16_t>(seen.size()));
+					if (added)
+						blocks_.insert(blocks_.end(), std::begin(block), std::end(block));
+					index_.emplace_back(it->second);
+				}
 				return true;
 			}
 			const std::vector<std::string> &list() const noexcept { return clist_; }
+			size_t tableSize() const noexcept {
+				return sizeof(uint16_t) * index_.size() + sizeof(CharInfo) * blocks_.size();
+			}
 
 			std::tuple<CharInfo, size_t, size_t, size_t> seekToOtherType(std::string_view sv, CharInfo c) const {
 				CharInfo fail;
@@ -62,30 +93,48 @@ namespace TMeCab {
 				}
 				return {fail, mlen, clen, blen};
 			}
-			std::tuple<CharInfo, size_t> getCharInfo(std::string_view str) const noexcept {
-				const auto [utf8, mlen] = utf8_to_ucs2(str);
-				return {cinfo_[utf8], mlen};
+			[[gnu::always_inline]] std::tuple<CharInfo, size_t> getCharInfo(std::string_view str) const noexcept {
+				const auto [c, mlen] = utf8_to_ucs4(str);
+				return {c < BmpSize ? cinfo_[c] : getOutOfBmp(c), mlen};
 			}
-			CharInfo getCharInfo(const uint16_t c) const noexcept { return cinfo_[c]; }
-		private:
-			// All internal codes are represented in UCS2.
-			std::tuple<uint16_t, size_t> utf8_to_ucs2(std::string_view str) const noexcept {
+			CharInfo getCharInfo(const uint32_t c) const noexcept {
+				return c < BmpSize ? cinfo_[c] : getOutOfBmp(c); // one load for the common case
+			}
+			// All internal codes are represented in UCS4 (U+0000..U+10FFFF).
+			std::tuple<uint32_t, size_t> utf8_to_ucs4(std::string_view str) const noexcept {
 				const auto len = str.size();
 				if (static_cast<uint8_t>(str[0]) < 0x80)
-					return {static_cast<uint16_t>(str[0]), 1};
+					return {static_cast<uint32_t>(str[0]), 1};
 				if (len >= 2 && (str[0] & 0xe0) == 0xc0)
-					return {static_cast<uint16_t>(((str[0] & 0x1f) << 6) | (str[1] & 0x3f)), 2};
+					return {static_cast<uint32_t>(((str[0] & 0x1f) << 6) | (str[1] & 0x3f)), 2};
 				if (len >= 3 && (str[0] & 0xf0) == 0xe0)
-					return {static_cast<uint16_t>(((str[0] & 0x0f) << 12) | ((str[1] & 0x3f) << 6) | (str[2] & 0x3f)), 3};
-				// belows are out of UCS2
-				if (len >= 4 && (str[0] & 0xf8) == 0xf0)
-					return {0, 4};
+					return {static_cast<uint32_t>(((str[0] & 0x0f) << 12) | ((str[1] & 0x3f) << 6) | (str[2] & 0x3f)), 3};
+				return utf8_to_ucs4_long(str);
+			}
+		private:
+			[[gnu::cold, gnu::noinline]] CharInfo getOutOfBmp(const uint32_t c) const noexcept {
+				return blocks_[(static_cast<size_t>(index_[(c >> BlockBits) - FirstBlock]) << BlockBits) | (c & (BlockSize - 1))];
+			}
+			// 4 bytes or more, out of the BMP
+			[[gnu::cold, gnu::noinline]] std::tuple<uint32_t, size_t> utf8_to_ucs4_long(std::string_view str) const noexcept {
+				const auto len = str.size();
+				if (len >= 4 && (str[0] & 0xf8) == 0xf0) {
+					const auto c = static_cast<uint32_t>(((str[0] & 0x07) << 18) | ((str[1] & 0x3f) << 12) | ((str[2] & 0x3f) << 6) | (str[3] & 0x3f));
+					return {c < MaxCode ? c : 0, 4};
+				}
+				// belows are out of Unicode
 				if (len >= 5 && (str[0] & 0xfc) == 0xf8)
 					return {0, 5};
 				if (len >= 6 && (str[0] & 0xfe) == 0xfc)
 					return {0, 6};
 				return {0, 1};
 			}
+			// Characters outside char.bin borrow the CharInfo of a similar character.
+			static constexpr uint32_t representative(const uint32_t c) noexcept {
+				if (0x20000 <= c && c <= 0x3ffff) return 0x4e00; // CJK Unified Ideographs Extension B..
+				if (0x1f000 <= c && c <= 0x1faff) return 0x2600; // Emoji, Pictographs
+				return 0;
+			}
 			uint32_t read32u(const char **ptr) const noexcept {
 				const uint32_t *r = reinterpret_cast<const uint32_t *>(*ptr);
 				*ptr += sizeof(uint32_t);
@@ -29,6 +29,7 @@ namespace TMeCab {
 				uint32_t   check;
 			};
 			const unit_t *array_;
+			std::vector<bool> redundant_; // never cheaper than another token of the same entry
 			const uint32_t DictionaryMagicID = 0xef718f77u;
 		public:
 			explicit Dictionary() {}
@@ -73,6 +74,7 @@ namespace TMeCab {
 					std::cerr << "dictionary file is broken: " << filename << std::endl;
 					return false;
 				}
+				findRedundant(dsize / sizeof(unit_t), tsize / sizeof(Token));
 				return true;
 			}
 			DA exactMatchSearch(std::string_view key) const noexcept {
@@ -113,10 +115,80 @@ namespace TMeCab {
 					result.emplace_back(token_ + ((-n-1) >> 8), (-n-1) & 0xff, len);
 				return result;
 			}
+			// Same as commonPrefixSearch() for each of n (<= DA_BATCH_SIZE) keys.
+			// The walks advance in lockstep and prefetch their next unit,
+			// so that the cache misses of one key overlap those of the others.
+			// depth, if given, receives the number of leading bytes each result depends on,
+			// or npos if the walk reached the end of the key.
+			void commonPrefixSearch(const std::string_view *keys, std::vector<DA> *result, const size_t n,
+				size_t *depth = nullptr) const noexcept {
+				uint32_t b[DA_BATCH_SIZE];
+				size_t   i[DA_BATCH_SIZE];
+				bool     done[DA_BATCH_SIZE];
+				for (size_t k = 0; k < n; ++k) {
+					result[k].clear();
+					b[k] = static_cast<uint32_t>(array_[0].base);
+					i[k] = 0;
+					done[k] = false;
+				}
+				for (size_t active = n; active;) {
+					for (size_t k = 0; k < n; ++k) {
+						if (done[k]) continue;
+						const auto key = keys[k];
+						uint32_t p = b[k];
+						const int32_t base = array_[p].base;
+						if (b[k] == array_[p].check && base < 0)
+							result[k].emplace_back(token_ + ((-base-1) >> 8), (-base-1) & 0xff, i[k]);
+						if (i[k] == key.size()) {
+							if (depth) depth[k] = std::string_view::npos;
+							done[k] = true;
+							--active;
+							continue;
+						}
+						p = b[k] + static_cast<uint8_t>(key[i[k]]) + 1;
+						if (b[k] != array_[p].check) {
+							if (depth) depth[k] = i[k] + 1;
+							done[k] = true;
+							--active;
+							continue;
+						}
+						b[k] = static_cast<uint32_t>(array_[p].base);
+						++i[k];
+						__builtin_prefetch(&array_[b[k]]);
+						if (i[k] < key.size())
+							__builtin_prefetch(&array_[b[k] + static_cast<uint8_t>(key[i[k]]) + 1]);
+					}
+				}
+			}
 			const char *feature(const Token &t) const noexcept {
 				return feature_ + t.feature;
 			}
+			// Tokens of an entry with the same lcAttr and rcAttr differ only in wcost,
+			// so only the cheapest (the first one if tied) can be on the best path.
+			bool isRedundant(const Token *t) const noexcept {
+				return redundant_[static_cast<size_t>(t - token_)];
+			}
 		private:
+			void findRedundant(const size_t units, const size_t tokens) noexcept {
+				redundant_.assign(tokens, false);
+				for (size_t p = 0; p < units; ++p) {
+					// a leaf is the 0 transition of its own base
+					const int32_t n = array_[p].base;
+					if (n >= 0 || array_[p].check != p) continue;
+					const auto first = static_cast<size_t>((-n-1) >> 8);
+					const auto size  = static_cast<size_t>((-n-1) & 0xff);
+					if (first + size > tokens) continue;
+					const Token *t = token_ + first;
+					for (size_t i = 0; i < size; ++i)
+						for (size_t k = 0; k < size; ++k) {
+							if (k == i || t[k].lcAttr != t[i].lcAttr || t[k].rcAttr != t[i].rcAttr) continue;
+							if (t[k].wcost < t[i].wcost || (t[k].wcost == t[i].wcost && k < i)) {
+								redundant_[first + i] = true;
+								break;
+							}
+						}
+				}
+			}
 			uint32_t read32u(const char **ptr) const noexcept {
 				const uint32_t *r = reinterpret_cast<const uint32_t *>(*ptr);
 				*ptr += sizeof(uint32_t);
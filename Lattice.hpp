@@ -2,114 +2,297 @@
 // Copyright(C) 2001-2011 Taku Kudo <taku@chasen.org>
 // Copyright(C) 2004-2006 Nippon Telegraph and Telephone Corporation
 #pragma once
+#include <algorithm>
+#include <chrono>
 #include <forward_list>
+#include <iterator>
 #include <limits>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include "tmecab.hpp"
 #include "Param.hpp"
-#include "CharProperty.hpp"
-#include "Dictionary.hpp"
+#include "Model.hpp"
+#include "LatticeDump.hpp"
+#include "LookupCache.hpp"
 #include "Writer.hpp"
 namespace TMeCab {
-	class Lattice {
+	struct LatticeStats {
+		size_t nodes;     // nodes created
+		size_t connects;  // connect evaluations
+		size_t maxFanIn;  // max size of endNodes
+		bool   fallback;
+		std::chrono::nanoseconds tokenize; // 0 unless profiled
+		std::chrono::nanoseconds connect;  // 0 unless profiled
+	};
+	// Cost: type of Node::cost, wide enough for the sentence (see Lattice::fits())
+	template <class Cost> class BasicLattice {
 		private:
+			using Node = BasicNode<Cost>;
 			std::string                            sentence_;
+			std::vector<size_t>                    boundaries_; // forced word boundaries (sorted)
+			std::string                            marker_;     // boundary marker stripped from input
 			std::vector<std::forward_list<Node *>> endNodes_;
 			std::forward_list<Node>                nodeList_;
 			std::forward_list<Node *>              tokens_;
+			size_t                                 eosPos_; // where EOS node is connected
+			bool                                   collapse_; // skip redundant homographs
 			Writer          writer_;
+			const Model    *model_; // Model of the current sentence, owned by Lattice
 			// Tokenize
-			Dictionary      sysdic_;
-			Dictionary      unkdic_;
-			CharProperty    property_;
-			CharInfo        space_;
-			std::vector<DA> unk_da_;
-			// Viterbi
-			Mmap<int16_t>   mmap_;
-			const int16_t  *matrix_;
-			size_t          lSize_;
-			size_t          rSize_;
+			std::string_view batchKeys_[DA_BATCH_SIZE];   // keys looked up in one batch
+			std::vector<DA>  batchResult_[DA_BATCH_SIZE];
+			size_t           batchSize_;
+			size_t           batchLimit_; // positions walked together (1: no batching)
+			LookupCache     *cache_;
+			std::string_view missKeys_[DA_BATCH_SIZE];    // keys not in cache_
+			std::vector<DA>  missResult_[DA_BATCH_SIZE];
+			// Budget (0: unlimited)
+			size_t          maxNodes_;
+			size_t          maxConnects_;
+			std::chrono::microseconds maxTime_;
+			size_t          nodes_;
+			size_t          connects_;
+			std::chrono::steady_clock::time_point start_;
+			bool            fallback_;
+			// Profile
+			bool            profile_;
+			std::chrono::nanoseconds tokenizeTime_;
+			std::chrono::nanoseconds connectTime_;
 		public:
-			explicit Lattice() {}
-			~Lattice() {}
-			bool open(const Param &param) noexcept {
-				const auto dicdir = param.get("dicdir");
-				if (!sysdic_.open(dicdir + SYS_DIC_FILE)) return false;
-				if (!unkdic_.open(dicdir + UNK_DIC_FILE)) return false;
-				if (!property_.open(dicdir + CHAR_PROPERTY_FILE)) return false;
-				for (auto&& key : property_.list()) {
-					// DEFAULT, SPACE, KANJI, SYMBOL...
-					const auto [token, tlen, len] = unkdic_.exactMatchSearch(key);
-					if (!token) {
-						std::cerr << "cannot find UNK category: " << key << std::endl;
-						return false;
-					}
-					unk_da_.emplace_back(token, tlen, len);
-				}
-				space_ = property_.getCharInfo(0x20); // ad-hoc
-				const auto file = dicdir + MATRIX_FILE;
-				if (!mmap_.open(file))
-					return false;
-				if (!mmap_.begin()) {
-					std::cerr << "matrix is NULL\n";
-					return false;
-				}
-				if (mmap_.size() <= 2) {
-					std::cerr << "invalid file size: " << file << std::endl;
-					return false;
-				}
-				lSize_ = static_cast<size_t>(mmap_[0]);
-				rSize_ = static_cast<size_t>(mmap_[1]);
-				if ((lSize_ * rSize_ + 2) != mmap_.size()) {
-					std::cerr << "invalid file size: " << file << std::endl;
-					return false;
-				}
-				matrix_ = mmap_.begin() + 2;
+			explicit BasicLattice() {}
+			~BasicLattice() {}
+			bool open(const Param &param, LookupCache *cache) noexcept {
+				cache_  = cache;
+				model_  = nullptr;
+				marker_      = param.get("boundary-marker");
+				maxNodes_    = param.getNumber<size_t>("max-nodes");
+				maxConnects_ = param.getNumber<size_t>("max-connects");
+				maxTime_     = std::chrono::microseconds(param.getNumber<int64_t>("max-time"));
+				profile_     = !param.get("slow-log").empty();
+				collapse_    = param.getNumber<size_t>("nbest", 1) <= 1; // N-best lists homographs
+				batchLimit_  = std::clamp<size_t>(param.getNumber<size_t>("lookup-batch", 1), 1, DA_BATCH_SIZE);
+
 				return writer_.open(param);
 			}
 
-			void setSentence(const std::string &sentence) noexcept {
+			// Every occurrence of boundary-marker is removed and becomes a forced word boundary.
+			void setSentence(const Model &model, const std::string &sentence) noexcept {
+				if (marker_.empty()) {
+					setSentence(model, sentence, {});
+					return;
+				}
+				std::string str;
+				std::vector<size_t> boundaries;
+				std::string_view sv{sentence};
+				for (auto n = sv.find(marker_); n != std::string_view::npos; n = sv.find(marker_)) {
+					str += sv.substr(0, n);
+					boundaries.emplace_back(str.size());
+					sv.remove_prefix(n + marker_.size());
+				}
+				str += sv;
+				setSentence(model, str, boundaries);
+			}
+			// No node crosses the byte offsets in boundaries.
+			// A boundary inside the white space before a morph is ignored.
+			void setSentence(const Model &model, const std::string &sentence, const std::vector<size_t> &boundaries) noexcept {
+				model_ = &model;
 				sentence_ = sentence;
+				boundaries_ = boundaries;
+				std::sort(boundaries_.begin(), boundaries_.end());
 				writer_.setSentence(sentence);
 				nodeList_.clear();
 				for (auto&& it : endNodes_)
 					it.clear();
 				endNodes_.clear();
 				endNodes_.resize(sentence_.size() + 1);
+				batchSize_ = 0;
+				nodes_    = 0;
+				connects_ = 0;
+				fallback_ = false;
+				tokenizeTime_ = tokenizeTime_.zero();
+				connectTime_  = connectTime_.zero();
 				endNodes_[0].emplace_front(newBosNode());
 			}
 
 			void viterbi() noexcept {
+				// The matrix layout is chosen once per sentence, not in every connect().
+				if (model_->isDedup())
+					viterbi(model_->dedupMatrix());
+				else
+					viterbi(model_->denseMatrix());
+			}
+
+			// true if the last viterbi() exceeded the budget and fell back to longest match
+			bool isFallback() const noexcept { return fallback_; }
+
+			LatticeStats stats() const noexcept {
+				size_t maxFanIn = 0;
+				for (auto&& it : endNodes_)
+					maxFanIn = std::max(maxFanIn, static_cast<size_t>(std::distance(it.begin(), it.end())));
+				return {nodes_, connects_, maxFanIn, fallback_, tokenizeTime_, connectTime_};
+			}
+
+			// Releases the lattice of the last sentence.
+			void clear() noexcept {
+				model_ = nullptr;
+				sentence_.clear();
+				sentence_.shrink_to_fit();
+				nodeList_.clear();
+				endNodes_.clear();
+				endNodes_.shrink_to_fit();
+			}
+
+			bool stringify(std::string &os) const noexcept {
+				os.clear();
+				if (endNodes_.empty())
+					return true; // not error
+				if (writer_.isSurfaceOnly()) {
+					writer_.writeSurfaces(bosNode(), os);
+					return true;
+				}
+				for (auto node = bosNode(); node; node = node->next)
+					if (!writer_.writeNode(node, feature(node), os))
+						return false;
+				return true;
+			}
+			// Writes the nbest best paths, each as stringify() does, followed by eon-format.
+			// Backward A* from EOS: Node::cost is the exact cost from BOS, so paths come out
+			// in order of cost and only the nodes of the listed paths are expanded.
+			bool stringify(std::string &os, const size_t nbest) const noexcept {
+				os.clear();
+				if (endNodes_.empty())
+					return true; // not error
+				struct Path {
+					const Node *node;
+					const Path *next; // towards EOS
+					int64_t     fx;   // cost of the whole path
+					int64_t     gx;   // cost from node to EOS
+				};
+				const auto greater = [](const Path *a, const Path *b) { return a->fx > b->fx; };
+				std::forward_list<Path> paths;
+				std::priority_queue<const Path *, std::vector<const Path *>, decltype(greater)> agenda(greater);
+				const Node *eosNode = nullptr;
+				for (auto node = bosNode(); node; node = node->next)
+					eosNode = node;
+				paths.push_front({eosNode, nullptr, eosNode->cost, 0});
+				agenda.push(&paths.front());
+				for (size_t n = 0; n < nbest && !agenda.empty();) {
+					const auto top = agenda.top();
+					agenda.pop();
+					const auto rNode = top->node;
+					if (rNode->stat == NodeStat::MECAB_BOS_NODE) {
+						for (auto path = top; path; path = path->next)
+							if (!writer_.writeNode(path->node, feature(path->node), os))
+								return false;
+						++n;
+						continue;
+					}
+					const auto &model = *model_;
+					for (auto&& lNode : endNodes_[startPos(rNode)]) {
+						if (lNode->stat == NodeStat::MECAB_EOS_NODE) continue; // connected to itself
+						const auto gx = top->gx + model.cost(lNode->rcAttr, rNode->lcAttr) + rNode->wcost;
+						paths.push_front({lNode, top, lNode->cost + gx, gx});
+						agenda.push(&paths.front());
+					}
+				}
+				return writer_.writeEon(eosNode, feature(eosNode), os);
+			}
+			// Appends the lattice of the last viterbi() to os; see DumpSentence.
+			void dump(std::string &os) const noexcept {
+				if (endNodes_.empty()) return;
+				std::unordered_set<const Node *> connected;
+				const Node *eosNode = nullptr;
+				for (auto&& it : endNodes_)
+					for (auto&& node : it) {
+						if (node->stat == NodeStat::MECAB_EOS_NODE) eosNode = node;
+						else if (node->stat != NodeStat::MECAB_BOS_NODE) connected.insert(node);
+					}
+				DumpSentence dump;
+				dump.length = static_cast<uint32_t>(sentence_.size());
+				dump.cost   = eosNode->cost;
+				std::unordered_map<uint16_t, uint16_t> lcAttr{{0, 0}}; // EOS
+				std::unordered_map<uint16_t, uint16_t> rcAttr{{0, 0}}; // BOS
+				std::vector<uint16_t> lcList{0};
+				std::vector<uint16_t> rcList{0};
+				for (auto&& node : nodeList_) { // the reverse of newNode(), that is the order of connect()
+					if (!connected.contains(&node)) continue;
+					const auto [lc, lcAdded] = lcAttr.try_emplace(node.lcAttr, static_cast<uint16_t>(lcList.size()));
+					if (lcAdded) lcList.emplace_back(node.lcAttr);
+					const auto [rc, rcAdded] = rcAttr.try_emplace(node.rcAttr, static_cast<uint16_t>(rcList.size()));
+					if (rcAdded) rcList.emplace_back(node.rcAttr);
+					dump.nodes.push_back({static_cast<uint32_t>(startPos(&node)), node.rlength, lc->second, rc->second, node.wcost});
+				}
+				std::stable_sort(dump.nodes.begin(), dump.nodes.end(),
+					[](const DumpNode &a, const DumpNode &b) { return a.pos < b.pos; });
+				dump.lcSize = static_cast<uint16_t>(lcList.size());
+				dump.rcSize = static_cast<uint16_t>(rcList.size());
+				// rcAttrs ending at pos x lcAttrs starting at pos, as connect() evaluated them
+				std::unordered_set<uint32_t> pairs;
+				const auto addPairs = [&](const size_t pos, const uint16_t lc) {
+					for (auto&& lNode : endNodes_[pos]) {
+						if (lNode->stat == NodeStat::MECAB_EOS_NODE) continue;
+						const auto rc = rcAttr.at(lNode->rcAttr);
+						if (pairs.insert(uint32_t{rc} << 16 | lc).second)
+							dump.pairs.push_back({rc, lc, model_->cost(rcList[rc], lcList[lc])});
+					}
+				};
+				for (auto&& node : dump.nodes)
+					addPairs(node.pos, node.lcAttr);
+				addPairs(eosPos_, 0); // EOS
+				dump.write(os);
+			}
+		private:
+			template <class Matrix> void viterbi(const Matrix &matrix) noexcept {
 				const std::string_view sv{sentence_};
 				const auto len = sv.size();
+				const bool limited = maxNodes_ || maxConnects_ || maxTime_.count();
+				if (limited) start_ = std::chrono::steady_clock::now();
 				for (size_t pos = 0; pos < len; ++pos) {
 					if (endNodes(pos).empty()) continue;
+					if (limited && isOverBudget()) {
+						fallback(pos, matrix);
+						break;
+					}
+					const auto t0 = now();
 					tokenize(sv.substr(pos));
+					const auto t1 = now();
 					for (auto&& it : tokens_)
-						connect(pos, it);
+						connect(pos, it, matrix);
+					if (profile_) {
+						tokenizeTime_ += t1 - t0;
+						connectTime_  += now() - t1;
+					}
 				}
 				const auto eosNode = newEosNode();
 				for (size_t pos = len + 1; pos--;) { // len..0
 					if (endNodes(pos).empty()) continue;
-					connect(pos, eosNode);
+					eosPos_ = pos;
+					connect(pos, eosNode, matrix);
 					break;
 				}
 				for (auto node = eosNode; node->prev; node = node->prev)
 					node->prev->next = node;
 			}
-
-			bool stringify(std::string &os) const noexcept {
-				os.clear();
-				if (endNodes_.empty())
-					return true; // not error
-				for (auto node = bosNode(); node; node = node->next)
-					if (!writer_.writeNode(node, os))
-						return false;
-				return true;
+			// Features are looked up only for the nodes written, and only if the format uses them.
+			const char *feature(const Node *node) const noexcept {
+				if (!writer_.needsFeature()) return "";
+				switch (node->stat) {
+					case NodeStat::MECAB_NOR_NODE: return model_->sysdic().feature(*node->token);
+					case NodeStat::MECAB_UNK_NODE: return model_->unkdic().feature(*node->token);
+					case NodeStat::MECAB_BOS_NODE:
+					case NodeStat::MECAB_EOS_NODE: break;
+				}
+				return BOS_FEATURE;
+			}
+			size_t startPos(const Node *node) const noexcept {
+				if (node->stat == NodeStat::MECAB_EOS_NODE) return eosPos_;
+				return static_cast<size_t>(node->surface + node->length - node->rlength - sentence_.data());
 			}
-		private:
 			Node *newNode(const NodeStat stat,
-				const char *surface, const char *feature,
+				const char *surface, const Token *token,
 				const uint16_t len = 0, const uint16_t slen = 0,
 				const uint16_t lcAttr = 0, const uint16_t rcAttr = 0,
 				const int16_t wcost = 0) noexcept {
@@ -117,7 +300,7 @@ namespace TMeCab {
 				node.prev    = nullptr;
 				node.next    = nullptr;
 				node.surface = surface;
-				node.feature = feature;
+				node.token   = token;
 				node.length  = len;
 				node.rlength = slen + len;
 				node.lcAttr  = lcAttr;
@@ -126,13 +309,14 @@ namespace TMeCab {
 				node.wcost   = wcost;
 				node.stat    = stat;
 				nodeList_.emplace_front(node);
+				++nodes_;
 				return &nodeList_.front();
 			}
 			Node *newBosNode() noexcept {
-				return newNode(NodeStat::MECAB_BOS_NODE, BOS_KEY, BOS_FEATURE);
+				return newNode(NodeStat::MECAB_BOS_NODE, BOS_KEY, nullptr);
 			}
 			Node *newEosNode() noexcept {
-				return newNode(NodeStat::MECAB_EOS_NODE, BOS_KEY, BOS_FEATURE);
+				return newNode(NodeStat::MECAB_EOS_NODE, BOS_KEY, nullptr);
 			}
 			Node *bosNode() const noexcept { return endNodes_[0].front(); }
 			std::forward_list<Node *> &endNodes(const size_t pos) noexcept {
@@ -144,17 +328,19 @@ namespace TMeCab {
 
 			void addNor(const DA &da, const char *surface, const size_t slen) noexcept {
 				auto [token, tsize, len] = da;
-				for (auto i = 0; i < tsize; ++i, ++token)
+				for (auto i = 0; i < tsize; ++i, ++token) {
+					if (collapse_ && model_->sysdic().isRedundant(token)) continue;
 					tokens_.emplace_front(newNode(NodeStat::MECAB_NOR_NODE,
-						surface, sysdic_.feature(*token),
+						surface, token,
 						static_cast<uint16_t>(len), static_cast<uint16_t>(slen),
 						token->lcAttr, token->rcAttr, token->wcost));
+				}
 			}
 			void addUnk(const CharInfo cinfo, const char *surface, const size_t len, const size_t slen) noexcept {
-				auto [token, tsize, xxx] = unk_da_[cinfo.default_type];
+				auto [token, tsize, xxx] = model_->unkDA(cinfo);
 				for (auto i = 0; i < tsize; ++i, ++token)
 					tokens_.emplace_front(newNode(NodeStat::MECAB_UNK_NODE,
-						surface, unkdic_.feature(*token),
+						surface, token,
 						static_cast<uint16_t>(len), static_cast<uint16_t>(slen),
 						token->lcAttr, token->rcAttr, token->wcost));
 			}
@@ -163,13 +349,13 @@ namespace TMeCab {
 				tokens_.clear();
 
 				// skip space
-				auto [cinfo, mlen, clen, blen] = property_.seekToOtherType(sv, space_);
+				auto [cinfo, mlen, clen, blen] = model_->property().seekToOtherType(sv, model_->space());
 				if (sv.size() == blen) return; // ends with space
 				const auto slen = blen; // space length
-				const auto surface = sv.substr(slen);
+				const auto surface = segment(sv.substr(slen));
 
 				// dictionary
-				const auto daresult = sysdic_.commonPrefixSearch(surface);
+				const auto &daresult = lookup(surface);
 				for (auto&& da : daresult)
 					addNor(da, surface.data(), slen);
 				if (!tokens_.empty() && !cinfo.invoke) return;
@@ -177,7 +363,7 @@ namespace TMeCab {
 				// Unknown words less than or equal to max-grouping-size characters
 				const char *isAdded = nullptr;
 				if (cinfo.group) {
-					std::tie(std::ignore, std::ignore, clen, blen) = property_.seekToOtherType(surface.substr(mlen), cinfo);
+					std::tie(std::ignore, std::ignore, clen, blen) = model_->property().seekToOtherType(surface.substr(mlen), cinfo);
 					const size_t ulen = mlen + blen;
 					const char *tail = surface.data() + ulen; // Tail of unknown word
 					if (clen <= MAX_GROUPING_SIZE)
@@ -191,17 +377,70 @@ namespace TMeCab {
 				for (auto i = 0; i < cinfo.length && tail < end; ++i) {
 					if (tail == isAdded) continue;
 					addUnk(cinfo, surface.data(), ulen, slen);
-					const auto [_cinfo, _mlen] = property_.getCharInfo(surface.substr(ulen));
+					if (ulen == surface.size()) break; // forced boundary
+					const auto [_cinfo, _mlen] = model_->property().getCharInfo(surface.substr(ulen));
 					if (!cinfo.isKindOf(_cinfo)) break;
 					tail += _mlen;
 					ulen += _mlen;
 				}
 			}
-			void connect(const size_t pos, Node *rNode) noexcept {
-				int64_t bestCost = std::numeric_limits<int64_t>::max();
+			// commonPrefixSearch() of surface, batched with up to lookup-batch - 1 following positions.
+			const std::vector<DA> &lookup(std::string_view surface) noexcept {
+				for (size_t k = 0; k < batchSize_; ++k)
+					if (batchKeys_[k].data() == surface.data())
+						return batchResult_[k];
+				batchSize_ = 0;
+				batchKeys_[batchSize_++] = surface;
+				const std::string_view sv{sentence_};
+				auto pos = static_cast<size_t>(surface.data() - sv.data());
+				pos += std::get<1>(model_->property().getCharInfo(surface));
+				while (pos < sv.size() && batchSize_ < batchLimit_) {
+					const auto [cinfo, mlen] = model_->property().getCharInfo(sv.substr(pos));
+					if (!model_->space().isKindOf(cinfo)) // a space is looked up from the next morph
+						batchKeys_[batchSize_++] = segment(sv.substr(pos));
+					pos += mlen;
+				}
+				if (!cache_->isOpen()) {
+					if (batchSize_ == 1)
+						batchResult_[0] = model_->sysdic().commonPrefixSearch(surface);
+					else
+						model_->sysdic().commonPrefixSearch(batchKeys_, batchResult_, batchSize_);
+					return batchResult_[0];
+				}
+				size_t misses = 0;
+				size_t index[DA_BATCH_SIZE];
+				for (size_t k = 0; k < batchSize_; ++k) {
+					if (const auto result = cache_->find(batchKeys_[k])) {
+						batchResult_[k].clear(); // DA is not assignable
+						for (auto&& da : *result)
+							batchResult_[k].emplace_back(da);
+						continue;
+					}
+					index[misses] = k;
+					missKeys_[misses++] = batchKeys_[k];
+				}
+				size_t depth[DA_BATCH_SIZE];
+				model_->sysdic().commonPrefixSearch(missKeys_, missResult_, misses, depth);
+				for (size_t m = 0; m < misses; ++m) {
+					cache_->insert(missKeys_[m], depth[m], missResult_[m]);
+					batchResult_[index[m]].swap(missResult_[m]);
+				}
+				return batchResult_[0];
+			}
+			// Truncates the surface at the next forced boundary.
+			std::string_view segment(std::string_view surface) const noexcept {
+				if (boundaries_.empty()) return surface;
+				const auto pos = static_cast<size_t>(surface.data() - sentence_.data());
+				const auto it = std::upper_bound(boundaries_.begin(), boundaries_.end(), pos);
+				if (it == boundaries_.end()) return surface;
+				return surface.substr(0, *it - pos);
+			}
+			template <class Matrix> void connect(const size_t pos, Node *rNode, const Matrix &matrix) noexcept {
+				Cost bestCost = std::numeric_limits<Cost>::max();
 				Node *bestNode = nullptr;
 				for (auto&& lNode : endNodes(pos)) {
-					const auto cost = lNode->cost + matrix_[lNode->rcAttr + lSize_ * rNode->lcAttr] + rNode->wcost;
+					++connects_;
+					const Cost cost = lNode->cost + matrix(lNode->rcAttr, rNode->lcAttr) + rNode->wcost;
 					if (bestCost > cost) {
 						bestCost = cost;
 						bestNode = lNode;
@@ -212,6 +451,129 @@ namespace TMeCab {
 				rNode->cost = bestCost;
 				addEndNode(pos + rNode->rlength, rNode);
 			}
+
+			std::chrono::steady_clock::time_point now() const noexcept {
+				return profile_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+			}
+			bool isOverBudget() const noexcept {
+				if (maxNodes_ && nodes_ > maxNodes_) return true;
+				if (maxConnects_ && connects_ > maxConnects_) return true;
+				if (maxTime_.count() && std::chrono::steady_clock::now() - start_ > maxTime_) return true;
+				return false;
+			}
+			// Segments the rest of the sentence from pos by longest match.
+			// Every node ending at pos is already connected, so the path up to pos is kept.
+			template <class Matrix> void fallback(size_t pos, const Matrix &matrix) noexcept {
+				const std::string_view sv{sentence_};
+				fallback_ = true;
+				for (auto i = pos + 1; i < endNodes_.size(); ++i)
+					endNodes_[i].clear();
+				while (pos < sv.size()) {
+					const auto node = longestMatch(sv.substr(pos));
+					if (!node) break; // ends with space
+					connect(pos, node, matrix);
+					pos += node->rlength;
+				}
+			}
+			Node *longestMatch(std::string_view sv) noexcept {
+				auto [cinfo, mlen, clen, blen] = model_->property().seekToOtherType(sv, model_->space());
+				if (sv.size() == blen) return nullptr;
+				const auto slen = blen; // space length
+				const auto surface = segment(sv.substr(slen));
+
+				const auto daresult = model_->sysdic().commonPrefixSearch(surface);
+				if (!daresult.empty() && std::get<2>(daresult.back())) {
+					const auto [token, tsize, len] = daresult.back();
+					const auto t = std::min_element(token, token + tsize,
+						[](const Token &a, const Token &b) { return a.wcost < b.wcost; });
+					return newNode(NodeStat::MECAB_NOR_NODE,
+						surface.data(), t,
+						static_cast<uint16_t>(len), static_cast<uint16_t>(slen),
+						t->lcAttr, t->rcAttr, t->wcost);
+				}
+
+				// Up to max-grouping-size characters as tokenize(), so rlength fits in uint16_t
+				size_t ulen = mlen;
+				if (cinfo.group) {
+					auto c = cinfo;
+					for (size_t i = 1; i < MAX_GROUPING_SIZE && ulen < surface.size(); ++i) {
+						const auto [_cinfo, _mlen] = model_->property().getCharInfo(surface.substr(ulen));
+						if (!c.isKindOf(_cinfo)) break;
+						ulen += _mlen;
+						c = _cinfo;
+					}
+				}
+				const auto [token, tsize, xxx] = model_->unkDA(cinfo);
+				const auto t = std::min_element(token, token + tsize,
+					[](const Token &a, const Token &b) { return a.wcost < b.wcost; });
+				return newNode(NodeStat::MECAB_UNK_NODE,
+					surface.data(), t,
+					static_cast<uint16_t>(ulen), static_cast<uint16_t>(slen),
+					t->lcAttr, t->rcAttr, t->wcost);
+			}
+	};
+
+	// Analyzes with 32-bit costs, which make Node 48 bytes instead of 56,
+	// unless the sentence is too long to rule out an overflow (see fits()).
+	class Lattice {
+		private:
+			BasicLattice<int32_t> narrow_;
+			BasicLattice<int64_t> wide_;
+			LookupCache           cache_; // shared by both
+			std::shared_ptr<SharedModel> shared_;
+			std::shared_ptr<const Model> model_; // Model of the current sentence
+			bool                  isWide_ = false;
+		public:
+			explicit Lattice() {}
+			~Lattice() {}
+			bool open(const Param &param) noexcept {
+				auto shared = std::make_shared<SharedModel>();
+				if (!shared->open(param)) return false;
+				return open(param, shared);
+			}
+			// Lattices opened with the same SharedModel see the same reload().
+			bool open(const Param &param, std::shared_ptr<SharedModel> shared) noexcept {
+				shared_ = shared;
+				cache_.open(param.getNumber<size_t>("lookup-cache"));
+				return narrow_.open(param, &cache_) && wide_.open(param, &cache_);
+			}
+			bool reload() noexcept { return shared_->reload(); }
+
+			void setSentence(const std::string &sentence) noexcept {
+				prepare(sentence.size());
+				isWide_ ? wide_.setSentence(*model_, sentence) : narrow_.setSentence(*model_, sentence);
+			}
+			void setSentence(const std::string &sentence, const std::vector<size_t> &boundaries) noexcept {
+				prepare(sentence.size());
+				isWide_ ? wide_.setSentence(*model_, sentence, boundaries) : narrow_.setSentence(*model_, sentence, boundaries);
+			}
+			void viterbi() noexcept { isWide_ ? wide_.viterbi() : narrow_.viterbi(); }
+			bool isFallback() const noexcept { return isWide_ ? wide_.isFallback() : narrow_.isFallback(); }
+			LatticeStats stats() const noexcept { return isWide_ ? wide_.stats() : narrow_.stats(); }
+			const LookupCache &cache() const noexcept { return cache_; }
+			bool stringify(std::string &os) const noexcept {
+				return isWide_ ? wide_.stringify(os) : narrow_.stringify(os);
+			}
+			bool stringify(std::string &os, const size_t nbest) const noexcept {
+				return isWide_ ? wide_.stringify(os, nbest) : narrow_.stringify(os, nbest);
+			}
+			void dump(std::string &os) const noexcept { isWide_ ? wide_.dump(os) : narrow_.dump(os); }
+		private:
+			// A step of a path costs at most 32768 + 32768 in absolute value (int16_t matrix and wcost),
+			// and a sentence of n bytes has at most n nodes and EOS.
+			static bool fits(const size_t size) noexcept {
+				constexpr int64_t MaxStepCost = -2 * int64_t{std::numeric_limits<int16_t>::min()};
+				return static_cast<int64_t>(size + 1) <= std::numeric_limits<int32_t>::max() / MaxStepCost;
+			}
+			// Takes the current Model for the next sentence and picks the lattice to run it.
+			void prepare(const size_t size) noexcept {
+				auto model = shared_->get();
+				if (model != model_) cache_.clear(); // reloaded
+				model_ = std::move(model); // the previous Model is released here
+				const bool wide = !fits(size);
+				if (isWide_ && !wide) wide_.clear(); // nodes of a long sentence
+				isWide_ = wide;
+			}
 	};
 }
 // vim:set ts=2 sts=2 sw=2 noet:
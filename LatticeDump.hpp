@@ -0,0 +1,135 @@
+// MeCab -- Yet Another Part-of-Speech and Morphological Analyzer
+// Copyright(C) 2001-2011 Taku Kudo <taku@chasen.org>
+// Copyright(C) 2004-2006 Nippon Telegraph and Telephone Corporation
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "tmecab.hpp"
+namespace TMeCab {
+	// A node of the lattice without surface and feature.
+	struct DumpNode {
+		uint32_t pos;     // start position including white space
+		uint16_t rlength;
+		uint16_t lcAttr;  // renumbered in the sentence
+		uint16_t rcAttr;  // renumbered in the sentence
+		int16_t  wcost;
+	};
+	// A connection cost evaluated in the sentence.
+	struct DumpPair {
+		uint16_t rcAttr;  // renumbered in the sentence
+		uint16_t lcAttr;  // renumbered in the sentence
+		int16_t  cost;
+	};
+	// One sentence of a lattice dump. In the file (native endian, no padding), after DumpHeader:
+	//   uint32 length, uint32 nodes, uint32 pairs, uint16 rcSize, uint16 lcSize, int64 cost,
+	//   DumpPair pair[pairs], DumpNode node[nodes]
+	// Nodes are sorted by pos, in the order Lattice connected them.
+	// rcAttr 0 is BOS and lcAttr 0 is EOS; pairs are only those connect() evaluates.
+	struct DumpSentence {
+		uint32_t length;
+		uint16_t rcSize;
+		uint16_t lcSize;
+		int64_t  cost; // cost of the best path
+		std::vector<DumpPair> pairs;
+		std::vector<DumpNode> nodes;
+		std::vector<int16_t>  matrix; // pairs expanded by read(): matrix[rcAttr + rcSize * lcAttr]
+
+		void write(std::string &os) const noexcept {
+			const uint32_t size  = static_cast<uint32_t>(nodes.size());
+			const uint32_t psize = static_cast<uint32_t>(pairs.size());
+			append(os, &length, sizeof(length));
+			append(os, &size, sizeof(size));
+			append(os, &psize, sizeof(psize));
+			append(os, &rcSize, sizeof(rcSize));
+			append(os, &lcSize, sizeof(lcSize));
+			append(os, &cost, sizeof(cost));
+			append(os, pairs.data(), sizeof(DumpPair) * pairs.size());
+			append(os, nodes.data(), sizeof(DumpNode) * nodes.size());
+		}
+		// false at the end of the file; a truncated or inconsistent record also sets badbit of is.
+		bool read(std::istream &is) noexcept {
+			if (!read(is, &length, sizeof(length))) return false;
+			if (!readBody(is)) {
+				is.setstate(std::ios::badbit);
+				return false;
+			}
+			return true;
+		}
+
+		// Best path cost by the same connect() as Lattice::viterbi().
+		// endNodes holds (cost, rcAttr) and is reused between calls.
+		int64_t viterbi(std::vector<std::vector<std::pair<int64_t, uint16_t>>> &endNodes) const noexcept {
+			for (auto&& it : endNodes)
+				it.clear();
+			endNodes.resize(length + 1);
+			endNodes[0].emplace_back(0, 0); // BOS
+			auto connect = [&](const size_t pos, const uint16_t lcAttr, const int16_t wcost) {
+				int64_t bestCost = std::numeric_limits<int64_t>::max();
+				for (auto&& [lcost, rcAttr] : endNodes[pos]) {
+					const auto cost = lcost + matrix[rcAttr + size_t{rcSize} * lcAttr] + wcost;
+					if (bestCost > cost) bestCost = cost;
+				}
+				return bestCost;
+			};
+			for (auto&& node : nodes) {
+				if (endNodes[node.pos].empty()) continue;
+				endNodes[node.pos + node.rlength].emplace_back(connect(node.pos, node.lcAttr, node.wcost), node.rcAttr);
+			}
+			for (size_t pos = length + 1; pos--;) // len..0
+				if (!endNodes[pos].empty())
+					return connect(pos, 0, 0); // EOS
+			return 0;
+		}
+		bool readBody(std::istream &is) noexcept {
+			uint32_t size;
+			uint32_t psize;
+			if (!read(is, &size, sizeof(size))) return false;
+			if (!read(is, &psize, sizeof(psize))) return false;
+			if (!read(is, &rcSize, sizeof(rcSize))) return false;
+			if (!read(is, &lcSize, sizeof(lcSize))) return false;
+			if (!read(is, &cost, sizeof(cost))) return false;
+			// rcAttr 0 (BOS) and lcAttr 0 (EOS) always exist
+			if (!rcSize || !lcSize || psize > size_t{rcSize} * lcSize) return false;
+			pairs.resize(psize);
+			if (!read(is, pairs.data(), sizeof(DumpPair) * pairs.size())) return false;
+			nodes.resize(size);
+			if (!read(is, nodes.data(), sizeof(DumpNode) * nodes.size())) return false;
+			for (auto&& n : nodes)
+				if (size_t{n.pos} + n.rlength > length || n.lcAttr >= lcSize || n.rcAttr >= rcSize) return false;
+			matrix.assign(size_t{rcSize} * lcSize, 0);
+			for (auto&& p : pairs) {
+				if (p.rcAttr >= rcSize || p.lcAttr >= lcSize) return false;
+				matrix[p.rcAttr + size_t{rcSize} * p.lcAttr] = p.cost;
+			}
+			return true;
+		}
+		static void append(std::string &os, const void *p, const size_t n) noexcept {
+			os.append(reinterpret_cast<const char *>(p), n);
+		}
+		static bool read(std::istream &is, void *p, const size_t n) noexcept {
+			return !!is.read(reinterpret_cast<char *>(p), static_cast<std::streamsize>(n));
+		}
+	};
+	// Head of a lattice dump file; dumps of another format are rejected.
+	struct DumpHeader {
+		static constexpr uint32_t Magic   = 0x444c4d54; // "TMLD" in little endian
+		static constexpr uint32_t Version = 2;          // 1: no header, dense matrix
+		uint32_t magic   = Magic;
+		uint32_t version = Version;
+
+		void write(std::string &os) const noexcept {
+			DumpSentence::append(os, &magic, sizeof(magic));
+			DumpSentence::append(os, &version, sizeof(version));
+		}
+		bool read(std::istream &is) noexcept {
+			if (!DumpSentence::read(is, &magic, sizeof(magic))) return false;
+			if (!DumpSentence::read(is, &version, sizeof(version))) return false;
+			return magic == Magic && version == Version;
+		}
+	};
+}
+// vim:set ts=2 sts=2 sw=2 noet:
@@ -0,0 +1,72 @@
+// MeCab -- Yet Another Part-of-Speech and Morphological Analyzer
+// Copyright(C) 2001-2011 Taku Kudo <taku@chasen.org>
+// Copyright(C) 2004-2006 Nippon Telegraph and Telephone Corporation
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "tmecab.hpp"
+#include "Dictionary.hpp"
+namespace TMeCab {
+	// Direct-mapped cache of commonPrefixSearch() results across sentences.
+	// An entry keeps the bytes the result depends on, that is up to the byte where
+	// the trie walk failed, so any key starting with them gives the same result.
+	class LookupCache {
+		private:
+			static constexpr size_t HashSize = 6; // bytes hashed to choose the slot
+			struct Entry {
+				std::string     prefix; // empty if unused
+				bool            whole;  // the walk reached the end of the key
+				std::vector<DA> result;
+			};
+			std::vector<Entry> entries_;
+			size_t             hits_;
+			size_t             misses_;
+		public:
+			explicit LookupCache(): hits_(0), misses_(0) {}
+			~LookupCache() {}
+			// size is rounded up to a power of 2; 0 disables the cache
+			void open(const size_t size) noexcept {
+				size_t n = size ? 1 : 0;
+				while (n && n < size) n <<= 1;
+				entries_.clear();
+				entries_.resize(n);
+			}
+			bool isOpen() const noexcept { return !entries_.empty(); }
+			void clear() noexcept {
+				for (auto&& e : entries_)
+					e.prefix.clear();
+			}
+			size_t hits() const noexcept { return hits_; }
+			size_t misses() const noexcept { return misses_; }
+
+			const std::vector<DA> *find(std::string_view key) noexcept {
+				const auto &e = entries_[slot(key)];
+				if (!e.prefix.empty() && (e.whole ? key == e.prefix : key.starts_with(e.prefix))) {
+					++hits_;
+					return &e.result;
+				}
+				++misses_;
+				return nullptr;
+			}
+			// depth: see Dictionary::commonPrefixSearch()
+			void insert(std::string_view key, const size_t depth, const std::vector<DA> &result) noexcept {
+				auto &e = entries_[slot(key)]; // evicts the previous one
+				e.whole  = depth == std::string_view::npos;
+				e.prefix = e.whole ? key : key.substr(0, depth);
+				e.result.clear(); // DA is not assignable
+				for (auto&& da : result)
+					e.result.emplace_back(da);
+			}
+		private:
+			size_t slot(std::string_view key) const noexcept {
+				uint64_t h = 0xcbf29ce484222325ull; // FNV-1a
+				for (auto c : key.substr(0, HashSize)) {
+					h ^= static_cast<uint8_t>(c);
+					h *= 0x100000001b3ull;
+				}
+				return static_cast<size_t>(h) & (entries_.size() - 1);
+			}
+	};
+}
+// vim:set ts=2 sts=2 sw=2 noet:
@@ -0,0 +1,210 @@
+// MeCab -- Yet Another Part-of-Speech and Morphological Analyzer
+// Copyright(C) 2001-2011 Taku Kudo <taku@chasen.org>
+// Copyright(C) 2004-2006 Nippon Telegraph and Telephone Corporation
+#pragma once
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "tmecab.hpp"
+#include "Param.hpp"
+#include "CharProperty.hpp"
+#include "Dictionary.hpp"
+#include "Mmap.hpp"
+namespace TMeCab {
+	// Head of the matrix file made by mkmatrix (native endian, no padding)
+	struct DedupHeader {
+		int16_t lSize;
+		int16_t rSize;
+		int16_t columns;
+		int16_t rows;
+		int64_t matrixSize;  // of the matrix.bin it was made from
+		int64_t matrixMtime; // of the matrix.bin it was made from, in nanoseconds
+
+		bool stamp(const std::string &matrix) noexcept {
+			struct stat st;
+			if (::stat(matrix.c_str(), &st) < 0) return false;
+			matrixSize  = static_cast<int64_t>(st.st_size);
+			matrixMtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+			return true;
+		}
+	};
+
+	// Connection costs of matrix.bin
+	struct DenseMatrix {
+		const int16_t *matrix;
+		size_t         lSize;
+		int16_t operator()(const uint16_t rcAttr, const uint16_t lcAttr) const noexcept {
+			return matrix[rcAttr + lSize * lcAttr];
+		}
+	};
+	// Connection costs of mkmatrix, whose identical columns and rows are stored once
+	struct DedupMatrix {
+		const int16_t  *matrix;
+		const uint16_t *column; // rcAttr -> column of matrix
+		const uint32_t *row;    // lcAttr -> offset of the row in matrix
+		int16_t operator()(const uint16_t rcAttr, const uint16_t lcAttr) const noexcept {
+			return matrix[row[lcAttr] + column[rcAttr]];
+		}
+	};
+
+	// sys.dic, unk.dic, char.bin and matrix.bin of one dicdir
+	class Model {
+		private:
+			Dictionary      sysdic_;
+			Dictionary      unkdic_;
+			CharProperty    property_;
+			CharInfo        space_;
+			std::vector<DA> unk_da_;
+			Mmap<int16_t>   mmap_;
+			const int16_t  *matrix_;
+			size_t          lSize_;
+			size_t          rSize_;
+			std::vector<uint16_t> column_; // rcAttr -> column of matrix_, if isDedup()
+			std::vector<uint32_t> row_;    // lcAttr -> offset of the row in matrix_, if isDedup()
+		public:
+			explicit Model() {}
+			~Model() {}
+			Model(const Model &) = delete;
+			Model &operator=(const Model &) = delete;
+			// dedup: file of mkmatrix in dicdir, used instead of matrix.bin if made from the current one
+			// extended: see CharProperty::open()
+			bool open(const std::string &dicdir, const std::string &dedup, const bool extended) noexcept {
+				if (!sysdic_.open(dicdir + SYS_DIC_FILE)) return false;
+				if (!unkdic_.open(dicdir + UNK_DIC_FILE)) return false;
+				if (!property_.open(dicdir + CHAR_PROPERTY_FILE, extended)) return false;
+				for (auto&& key : property_.list()) {
+					// DEFAULT, SPACE, KANJI, SYMBOL...
+					const auto [token, tlen, len] = unkdic_.exactMatchSearch(key);
+					if (!token) {
+						std::cerr << "cannot find UNK category: " << key << std::endl;
+						return false;
+					}
+					unk_da_.emplace_back(token, tlen, len);
+				}
+				space_ = property_.getCharInfo(0x20); // ad-hoc
+				const auto matrix = dicdir + MATRIX_FILE;
+				if (!dedup.empty()) {
+					if (isDedupOf(dicdir + dedup, matrix))
+						return openDedupMatrix(dicdir + dedup);
+					std::cerr << "not made from " << matrix << ", ignored: " << dicdir + dedup << std::endl;
+				}
+				return openMatrix(matrix);
+			}
+			const Dictionary   &sysdic() const noexcept { return sysdic_; }
+			const Dictionary   &unkdic() const noexcept { return unkdic_; }
+			const CharProperty &property() const noexcept { return property_; }
+			CharInfo space() const noexcept { return space_; }
+			const DA &unkDA(const CharInfo cinfo) const noexcept { return unk_da_[cinfo.default_type]; }
+			bool isDedup() const noexcept { return !column_.empty(); }
+			DenseMatrix denseMatrix() const noexcept { return {matrix_, lSize_}; }
+			DedupMatrix dedupMatrix() const noexcept { return {matrix_, column_.data(), row_.data()}; }
+			int16_t cost(const uint16_t rcAttr, const uint16_t lcAttr) const noexcept {
+				return isDedup() ? dedupMatrix()(rcAttr, lcAttr) : denseMatrix()(rcAttr, lcAttr);
+			}
+		private:
+			bool openMatrix(const std::string &file) noexcept {
+				if (!openMatrixHeader(file)) return false;
+				if ((lSize_ * rSize_ + 2) != mmap_.size()) {
+					std::cerr << "invalid file size: " << file << std::endl;
+					return false;
+				}
+				matrix_ = mmap_.begin() + 2;
+				return true;
+			}
+			// true if file is stamped with the current size and mtime of matrix
+			static bool isDedupOf(const std::string &file, const std::string &matrix) noexcept {
+				DedupHeader header;
+				std::ifstream is(file, std::ios::binary);
+				if (!is.read(reinterpret_cast<char *>(&header), sizeof(header))) return false;
+				int16_t size[2]; // lSize, rSize
+				std::ifstream ms(matrix, std::ios::binary);
+				if (!ms.read(reinterpret_cast<char *>(size), sizeof(size))) return false;
+				DedupHeader current;
+				if (!current.stamp(matrix)) return false;
+				return header.lSize == size[0] && header.rSize == size[1]
+					&& header.matrixSize == current.matrixSize && header.matrixMtime == current.matrixMtime;
+			}
+			// DedupHeader, column[lSize], row[rSize], matrix[rows * columns]
+			// Identical columns and rows of matrix.bin are stored once; costs are exact.
+			bool openDedupMatrix(const std::string &file) noexcept {
+				constexpr size_t HeaderSize = sizeof(DedupHeader) / sizeof(int16_t);
+				if (!openMatrixHeader(file)) return false;
+				if (mmap_.size() < HeaderSize) {
+					std::cerr << "invalid file size: " << file << std::endl;
+					return false;
+				}
+				const auto columns = static_cast<uint16_t>(mmap_[2]);
+				const auto rows    = static_cast<uint16_t>(mmap_[3]);
+				if ((HeaderSize + lSize_ + rSize_ + size_t{columns} * rows) != mmap_.size()) {
+					std::cerr << "invalid file size: " << file << std::endl;
+					return false;
+				}
+				const auto column = reinterpret_cast<const uint16_t *>(mmap_.begin() + HeaderSize);
+				const auto row    = column + lSize_;
+				column_.assign(column, column + lSize_);
+				row_.resize(rSize_);
+				for (size_t i = 0; i < rSize_; ++i)
+					row_[i] = static_cast<uint32_t>(row[i]) * columns;
+				if (std::any_of(column_.begin(), column_.end(), [&](auto c) { return c >= columns; })
+					|| std::any_of(row, row + rSize_, [&](auto r) { return r >= rows; })) {
+					std::cerr << "matrix is broken: " << file << std::endl;
+					return false;
+				}
+				matrix_ = mmap_.begin() + HeaderSize + lSize_ + rSize_;
+				return true;
+			}
+			bool openMatrixHeader(const std::string &file) noexcept {
+				if (!mmap_.open(file))
+					return false;
+				if (!mmap_.begin()) {
+					std::cerr << "matrix is NULL\n";
+					return false;
+				}
+				if (mmap_.size() <= 2) {
+					std::cerr << "invalid file size: " << file << std::endl;
+					return false;
+				}
+				lSize_ = static_cast<uint16_t>(mmap_[0]);
+				rSize_ = static_cast<uint16_t>(mmap_[1]);
+				return true;
+			}
+	};
+
+	// The Model currently in use, shared by any number of Lattices.
+	// reload() opens the dicdir again and replaces it for the following sentences;
+	// the old Model is unmapped when the last sentence using it is done.
+	class SharedModel {
+		private:
+			mutable std::mutex           mutex_;
+			std::shared_ptr<const Model> model_;
+			std::string                  dicdir_;
+			std::string                  dedup_;
+			bool                         extended_;
+		public:
+			explicit SharedModel() {}
+			~SharedModel() {}
+			bool open(const Param &param) noexcept {
+				dicdir_   = param.get("dicdir");
+				dedup_    = param.get("matrix-dedup");
+				extended_ = param.getNumber<int>("extended-char-class") != 0;
+				return reload();
+			}
+			bool reload() noexcept {
+				auto model = std::make_shared<Model>();
+				if (!model->open(dicdir_, dedup_, extended_)) return false; // keep the current one
+				std::shared_ptr<const Model> old = std::move(model);
+				std::lock_guard<std::mutex> lock(mutex_);
+				model_.swap(old); // old is released after unlock
+				return true;
+			}
+			std::shared_ptr<const Model> get() const noexcept {
+				std::lock_guard<std::mutex> lock(mutex_);
+				return model_;
+			}
+	};
+}
+// vim:set ts=2 sts=2 sw=2 noet:
@@ -2,6 +2,7 @@
 // Copyright(C) 2001-2011 Taku Kudo <taku@chasen.org>
 // Copyright(C) 2004-2006 Nippon Telegraph and Telephone Corporation
 #pragma once
+#include <charconv>
 #include <cstdio>
 #include <string>
 #include <unordered_map>
@@ -105,6 +106,13 @@ namespace TMeCab {
 				const auto it = conf_.find(key);
 				return it == conf_.end() ? def : it->second;
 			}
+			template <class T> T getNumber(const std::string &key, const T def = 0) const noexcept {
+				const auto val = get(key);
+				T n = def;
+				if (std::from_chars(val.data(), val.data() + val.size(), n).ec != std::errc())
+					return def;
+				return n;
+			}
 		private:
 			void set(const char *key, const std::string &val) noexcept {
 				conf_.insert_or_assign(key, val);
@@ -0,0 +1,112 @@
+// MeCab -- Yet Another Part-of-Speech and Morphological Analyzer
+// Copyright(C) 2001-2011 Taku Kudo <taku@chasen.org>
+// Copyright(C) 2004-2006 Nippon Telegraph and Telephone Corporation
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include "tmecab.hpp"
+#include "Param.hpp"
+#include "Lattice.hpp"
+namespace TMeCab {
+	// Writes sentences slower than slow-time (microseconds) or larger than slow-nodes
+	// to slow-log in JSON Lines. Without thresholds every sentence is written.
+	class SlowLog {
+		private:
+			std::ofstream os_;
+			std::chrono::microseconds time_;
+			size_t        nodes_;
+		public:
+			explicit SlowLog() {}
+			~SlowLog() {}
+			bool open(const Param &param) noexcept {
+				const auto file = param.get("slow-log");
+				if (file.empty()) return true; // disabled
+				os_.open(file, std::ios::app);
+				if (!os_) {
+					std::cerr << "open failed: " << file << std::endl;
+					return false;
+				}
+				time_  = std::chrono::microseconds(param.getNumber<int64_t>("slow-time"));
+				nodes_ = param.getNumber<size_t>("slow-nodes");
+				return true;
+			}
+			bool isOpen() const noexcept { return os_.is_open(); }
+			std::chrono::steady_clock::time_point now() const noexcept {
+				return isOpen() ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+			}
+			// analyze: setSentence() and viterbi(), output: stringify()
+			void write(std::string_view sentence, const Lattice &lattice,
+				const std::chrono::nanoseconds analyze, const std::chrono::nanoseconds output) noexcept {
+				if (!isOpen()) return;
+				const auto total = analyze + output;
+				const auto stats = lattice.stats();
+				if (time_.count() || nodes_) {
+					const bool slow = time_.count() && total >= time_;
+					const bool large = nodes_ && stats.nodes >= nodes_;
+					if (!slow && !large) return;
+				}
+				std::string str;
+				str += "{\"hash\":\"";
+				char buf[17];
+				std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(fnv1a(sentence)));
+				str += buf;
+				str += "\",\"prefix\":\"";
+				addEscaped(str, prefix(sentence));
+				str += "\",\"length\":" + std::to_string(sentence.size());
+				str += ",\"nodes\":" + std::to_string(stats.nodes);
+				str += ",\"max_fanin\":" + std::to_string(stats.maxFanIn);
+				str += ",\"connects\":" + std::to_string(stats.connects);
+				str += ",\"fallback\":";
+				str += stats.fallback ? "true" : "false";
+				str += ",\"time_us\":{\"tokenize\":" + std::to_string(usec(stats.tokenize));
+				str += ",\"connect\":" + std::to_string(usec(stats.connect));
+				str += ",\"analyze\":" + std::to_string(usec(analyze));
+				str += ",\"output\":" + std::to_string(usec(output));
+				str += ",\"total\":" + std::to_string(usec(total));
+				str += "}}\n";
+				os_ << str << std::flush;
+			}
+		private:
+			static int64_t usec(const std::chrono::nanoseconds t) noexcept {
+				return std::chrono::duration_cast<std::chrono::microseconds>(t).count();
+			}
+			static uint64_t fnv1a(std::string_view sv) noexcept {
+				uint64_t h = 0xcbf29ce484222325ull;
+				for (auto c : sv) {
+					h ^= static_cast<uint8_t>(c);
+					h *= 0x100000001b3ull;
+				}
+				return h;
+			}
+			// At most SLOW_LOG_PREFIX bytes, not splitting a UTF-8 sequence.
+			static std::string_view prefix(std::string_view sv) noexcept {
+				if (sv.size() <= SLOW_LOG_PREFIX) return sv;
+				size_t n = SLOW_LOG_PREFIX;
+				while (n && (static_cast<uint8_t>(sv[n]) & 0xc0) == 0x80) --n;
+				return sv.substr(0, n);
+			}
+			static void addEscaped(std::string &os, std::string_view sv) noexcept {
+				for (auto c : sv) {
+					switch (c) {
+						case '"':  os += "\\\""; break;
+						case '\\': os += "\\\\"; break;
+						case '\t': os += "\\t"; break;
+						case '\r': os += "\\r"; break;
+						case '\n': os += "\\n"; break;
+						default:
+							if (static_cast<uint8_t>(c) < 0x20) {
+								char buf[7];
+								std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+								os += buf;
+							} else
+								os += c;
+							break;
+					}
+				}
+			}
+	};
+}
+// vim:set ts=2 sts=2 sw=2 noet:
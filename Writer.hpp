@@ -16,7 +16,13 @@ namespace TMeCab {
 			std::string unkFmt_; // unknown node format
 			std::string bosFmt_; // BOS node format
 			std::string eosFmt_; // EOS node format
+			std::string eonFmt_; // end of N-best format
 			std::string_view sentence_;
+			bool needsFeature_;  // some format uses %H, %f or %F
+			bool surfaceOnly_;   // node format is %m and a literal, the others are literals (wakati)
+			std::string bosStr_; // expanded formats for surfaceOnly_
+			std::string eosStr_;
+			std::string sepStr_;
 		public:
 			explicit Writer() {}
 			~Writer() {}
@@ -25,10 +31,12 @@ namespace TMeCab {
 				std::string unkKey = "unk-format";
 				std::string bosKey = "bos-format";
 				std::string eosKey = "eos-format";
+				std::string eonKey = "eon-format";
 				norFmt_ = param.get(norKey, "%m\\t%H\\n");
 				unkFmt_ = param.get(unkKey, norFmt_);
 				bosFmt_ = param.get(bosKey, "");
 				eosFmt_ = param.get(eosKey, "EOS\\n");
+				eonFmt_ = param.get(eonKey, "");
 
 				const auto formatType = param.get("output-format-type");
 				if (!formatType.empty()) {
@@ -37,6 +45,7 @@ namespace TMeCab {
 					unkKey += fType;
 					bosKey += fType;
 					eosKey += fType;
+					eonKey += fType;
 					const auto tmp = param.get(norKey);
 					if (tmp.empty()) {
 						std::cerr << "unkown format type [" << formatType << "]\n";
@@ -47,20 +56,50 @@ namespace TMeCab {
 				unkFmt_ = param.get(unkKey, norFmt_);
 				bosFmt_ = param.get(bosKey, bosFmt_);
 				eosFmt_ = param.get(eosKey, eosFmt_);
+				eonFmt_ = param.get(eonKey, eonFmt_);
+
+				needsFeature_ = false;
+				for (auto&& fmt : {norFmt_, unkFmt_, bosFmt_, eosFmt_, eonFmt_})
+					for (auto&& macro : {"%H", "%f", "%F"})
+						if (fmt.find(macro) != std::string::npos)
+							needsFeature_ = true;
+				const std::string_view nor{norFmt_};
+				surfaceOnly_ = norFmt_ == unkFmt_ && nor.starts_with("%m") && isLiteral(nor.substr(2))
+					&& isLiteral(bosFmt_) && isLiteral(eosFmt_);
+				if (surfaceOnly_) {
+					sepStr_ = expand(nor.substr(2));
+					bosStr_ = expand(bosFmt_);
+					eosStr_ = expand(eosFmt_);
+				}
 				return true;
 			}
+			bool needsFeature() const noexcept { return needsFeature_; }
+			bool isSurfaceOnly() const noexcept { return surfaceOnly_; }
 			void setSentence(std::string_view sentence) noexcept {
 				sentence_ = sentence;
 			}
-			bool writeNode(const Node *node, std::string &os) const noexcept {
+			// feature: feature string of node, if needsFeature()
+			bool writeNode(const auto *node, const char *feature, std::string &os) const noexcept {
 				switch (node->stat) {
-					case NodeStat::MECAB_NOR_NODE: return writeNode(norFmt_, node, os);
-					case NodeStat::MECAB_UNK_NODE: return writeNode(unkFmt_, node, os);
-					case NodeStat::MECAB_BOS_NODE: return writeNode(bosFmt_, node, os);
-					case NodeStat::MECAB_EOS_NODE: return writeNode(eosFmt_, node, os);
+					case NodeStat::MECAB_NOR_NODE: return writeNode(norFmt_, node, feature, os);
+					case NodeStat::MECAB_UNK_NODE: return writeNode(unkFmt_, node, feature, os);
+					case NodeStat::MECAB_BOS_NODE: return writeNode(bosFmt_, node, feature, os);
+					case NodeStat::MECAB_EOS_NODE: return writeNode(eosFmt_, node, feature, os);
 				}
 				return false;
 			}
+			bool writeEon(const auto *eosNode, const char *feature, std::string &os) const noexcept {
+				return writeNode(eonFmt_, eosNode, feature, os);
+			}
+			// The path from bosNode without interpreting the formats, if isSurfaceOnly()
+			void writeSurfaces(const auto *bosNode, std::string &os) const noexcept {
+				os += bosStr_;
+				for (auto node = bosNode->next; node && node->next; node = node->next) {
+					os.append(node->surface, node->length);
+					os += sepStr_;
+				}
+				os += eosStr_;
+			}
 		private:
 			void addString(std::string &os, const auto v) const noexcept {
 				char buf[8]{};
@@ -68,7 +107,7 @@ namespace TMeCab {
 				if (ec == std::errc())
 					os.append(buf, static_cast<size_t>(ptr - buf));
 			}
-			bool writeNode(std::string_view format, const Node *node, std::string &os) const noexcept {
+			bool writeNode(std::string_view format, const auto *node, const char *feature, std::string &os) const noexcept {
 				std::vector<std::string> csv;
 				for (const char *p = format.data(); *p; ++p) {
 					switch (*p) {
@@ -99,16 +138,16 @@ namespace TMeCab {
 									os.append(node->surface - node->rlength + node->length, node->rlength);
 									break;
 								case 'H':
-									os += node->feature;
+									os += feature;
 									break;
 								case 'F':
 								case 'f':
-									if (node->feature[0] == '\0') {
+									if (feature[0] == '\0') {
 										std::cerr << "no feature information available\n";
 										return false;
 									}
 									if (csv.empty())
-										csv = splitCsv(node->feature);
+										csv = splitCsv(feature);
 									auto separator = '\t'; // default separator
 									if (*p == 'F') // change separator
 										separator = (*++p == '\\') ? escapedChar(*++p) : *p;
@@ -159,6 +198,16 @@ namespace TMeCab {
 				}
 				return true;
 			}
+			static bool isLiteral(std::string_view format) noexcept {
+				return format.find('%') == std::string_view::npos;
+			}
+			// A literal format as writeNode() writes it
+			std::string expand(std::string_view format) const noexcept {
+				std::string os;
+				for (const char *p = format.data(); *p; ++p)
+					os += (*p == '\\') ? escapedChar(*++p) : *p;
+				return os;
+			}
 			std::vector<std::string> splitCsv(std::string_view str) const noexcept {
 				std::vector<std::string> sv;
 				const char *bos = str.data();
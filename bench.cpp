@@ -0,0 +1,220 @@
+// MeCab -- Yet Another Part-of-Speech and Morphological Analyzer
+// Copyright(C) 2001-2011 Taku Kudo <taku@chasen.org>
+// Copyright(C) 2004-2006 Nippon Telegraph and Telephone Corporation
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <cstdlib>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tmecab.hpp"
+#include "Param.hpp"
+#include "Stream.hpp"
+#include "CharProperty.hpp"
+#include "Dictionary.hpp"
+#include "Lattice.hpp"
+namespace TMeCab {
+	const TMeCab::Option options[] = {
+		{"rcfile",             'r'}, // resource file
+		{"dicdir",             'd'}, // system dicdir
+		{"repeat",             'n'}, // number of iterations
+		{"threads",            't'}, // number of analyzing threads for reload
+		{"replay",             'l'}, // lattice file of tmecab --dump-lattice
+		{"matrix-dedup",       '\0'}, // file of mkmatrix in dicdir, instead of matrix.bin
+		{"extended-char-class", '\0'}, // classify CJK Ext. B+ and emoji like U+4E00 and U+2600
+		{nullptr, '\0'}
+	};
+
+	template <class F> void measure(const char *name, const size_t repeat, F f) {
+		size_t n = 0;
+		const auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < repeat; ++i)
+			n += f();
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << std::left << std::setw(24) << name
+			<< std::right << std::setw(12) << std::fixed << std::setprecision(3) << elapsed.count() << " ms"
+			<< std::setw(12) << n << std::endl;
+	}
+
+	// Dictionary::commonPrefixSearch() from every character of the corpus
+	void benchTrie(const Dictionary &dic, const std::vector<std::string> &lines, const size_t repeat) {
+		std::vector<std::string_view> keys;
+		for (auto&& line : lines) {
+			const std::string_view sv{line};
+			for (size_t pos = 0; pos < sv.size(); ++pos)
+				if ((static_cast<uint8_t>(sv[pos]) & 0xc0) != 0x80)
+					keys.emplace_back(sv.substr(pos));
+		}
+		measure("trie/single", repeat, [&] {
+			size_t n = 0;
+			for (auto&& key : keys)
+				n += dic.commonPrefixSearch(key).size();
+			return n;
+		});
+		measure("trie/batch", repeat, [&] {
+			size_t n = 0;
+			std::vector<DA> result[DA_BATCH_SIZE];
+			for (size_t i = 0; i < keys.size(); i += DA_BATCH_SIZE) {
+				const auto size = std::min<size_t>(DA_BATCH_SIZE, keys.size() - i);
+				dic.commonPrefixSearch(&keys[i], result, size);
+				for (size_t k = 0; k < size; ++k)
+					n += result[k].size();
+			}
+			return n;
+		});
+	}
+
+	// CharProperty::getCharInfo() against the flat UCS2 table of char.bin
+	bool benchChar(const std::string &file, const std::vector<std::string> &lines, const size_t repeat) {
+		CharProperty property;
+		if (!property.open(file, false)) return false;
+		Mmap<char> mmap;
+		if (!mmap.open(file)) return false;
+		const auto csize = *reinterpret_cast<const uint32_t *>(mmap.begin());
+		const auto flat = reinterpret_cast<const CharInfo *>(mmap.begin() + sizeof(uint32_t) + csize * 32);
+		// Both decode with CharProperty::utf8_to_ucs4(), so only the table lookup differs.
+		measure("char/flat", repeat, [&] {
+			size_t n = 0;
+			for (auto&& line : lines)
+				for (std::string_view sv{line}; !sv.empty();) {
+					const auto [c, mlen] = property.utf8_to_ucs4(sv);
+					n += flat[c < 0xffff ? c : 0].default_type;
+					sv.remove_prefix(mlen);
+				}
+			return n;
+		});
+		measure("char/two-level", repeat, [&] {
+			size_t n = 0;
+			for (auto&& line : lines)
+				for (std::string_view sv{line}; !sv.empty();) {
+					const auto [c, mlen] = property.utf8_to_ucs4(sv);
+					n += property.getCharInfo(c).default_type;
+					sv.remove_prefix(mlen);
+				}
+			return n;
+		});
+		std::cout << "char/two-level table above U+FFFE: " << property.tableSize() << " bytes (flat: "
+			<< sizeof(CharInfo) * 0xffff << " bytes)" << std::endl;
+		return true;
+	}
+
+	// The connect phase alone over lattices saved by tmecab --dump-lattice; no dictionary is needed.
+	bool benchReplay(const std::string &file, const size_t repeat) {
+		std::ifstream is(file, std::ios::binary);
+		if (!is) {
+			std::cerr << "input failed: " << file << std::endl;
+			return false;
+		}
+		if (DumpHeader header; !header.read(is)) {
+			std::cerr << "not a lattice dump of this version: " << file << std::endl;
+			return false;
+		}
+		std::vector<DumpSentence> sentences;
+		for (DumpSentence s; s.read(is);)
+			sentences.emplace_back(s);
+		if (is.bad()) {
+			std::cerr << "broken lattice dump: " << file << ":" << sentences.size() + 1 << std::endl;
+			return false;
+		}
+		size_t nodes = 0;
+		for (auto&& s : sentences)
+			nodes += s.nodes.size();
+		std::cout << file << ": " << sentences.size() << " sentences, " << nodes << " nodes" << std::endl;
+		bool ok = true;
+		std::vector<std::vector<std::pair<int64_t, uint16_t>>> endNodes;
+		measure("replay", repeat, [&] {
+			for (auto&& s : sentences)
+				if (s.viterbi(endNodes) != s.cost) ok = false;
+			return nodes;
+		});
+		std::cout << "replay: " << (ok ? "OK" : "NG") << std::endl;
+		return ok;
+	}
+
+	// Analyzes the corpus on several threads while the dictionaries are reloaded over and over.
+	// Every sentence must give the same result as without reload.
+	bool benchReload(const Param &param, const std::vector<std::string> &lines, const size_t repeat) {
+		auto shared = std::make_shared<SharedModel>();
+		if (!shared->open(param)) return false;
+		std::vector<std::string> expected(lines.size());
+		{
+			Lattice lattice;
+			if (!lattice.open(param, shared)) return false;
+			for (size_t i = 0; i < lines.size(); ++i) {
+				lattice.setSentence(lines[i]);
+				lattice.viterbi();
+				lattice.stringify(expected[i]);
+			}
+		}
+		std::atomic<bool> ok = true;
+		std::atomic<bool> running = true;
+		std::atomic<size_t> reloads = 0;
+		measure("reload", repeat, [&] {
+			running = true;
+			std::jthread reloader([&] {
+				while (running) {
+					if (!shared->reload()) ok = false;
+					++reloads;
+				}
+			});
+			std::vector<std::jthread> workers;
+			for (auto n = param.getNumber<size_t>("threads", 4); n; --n)
+				workers.emplace_back([&] {
+					Lattice lattice;
+					if (!lattice.open(param, shared)) {
+						ok = false;
+						return;
+					}
+					std::string str;
+					for (size_t i = 0; i < lines.size(); ++i) {
+						lattice.setSentence(lines[i]);
+						lattice.viterbi();
+						lattice.stringify(str);
+						if (str != expected[i]) ok = false;
+					}
+				});
+			workers.clear(); // join
+			running = false;
+			return lines.size();
+		});
+		std::cout << "reloads: " << reloads << (ok ? " OK" : " NG") << std::endl;
+		return ok;
+	}
+}
+int main(int argc, char **argv) {
+	TMeCab::Param param;
+	if (!param.open(argc, argv, TMeCab::options))
+		return 1;
+	const auto repeat = param.getNumber<size_t>("repeat", 10);
+	const auto replay = param.get("replay");
+	if (!replay.empty())
+		return TMeCab::benchReplay(replay, repeat) ? 0 : 1;
+
+	if (!param.loadDictionaryResource())
+		return 1;
+	const auto dicdir = param.get("dicdir");
+
+	std::vector<std::string> lines;
+	auto files = param.restArgs();
+	if (files.empty()) files.push_back("-");
+	for (auto&& file : files) {
+		TMeCab::iStream is(file);
+		if (!*is) {
+			std::cerr << "input failed: " << file << std::endl;
+			return 1;
+		}
+		for (std::string line; std::getline(*is, line);)
+			lines.emplace_back(line);
+	}
+
+	TMeCab::Dictionary sysdic;
+	if (!sysdic.open(dicdir + SYS_DIC_FILE)) return 1;
+	TMeCab::benchTrie(sysdic, lines, repeat);
+	if (!TMeCab::benchChar(dicdir + CHAR_PROPERTY_FILE, lines, repeat)) return 1;
+	if (!TMeCab::benchReload(param, lines, repeat)) return 1;
+	return 0;
+}
+// vim:set ts=2 sts=2 sw=2 noet:
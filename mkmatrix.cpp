@@ -0,0 +1,103 @@
+// MeCab -- Yet Another Part-of-Speech and Morphological Analyzer
+// Copyright(C) 2001-2011 Taku Kudo <taku@chasen.org>
+// Copyright(C) 2004-2006 Nippon Telegraph and Telephone Corporation
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "tmecab.hpp"
+#include "Param.hpp"
+#include "Mmap.hpp"
+#include "Model.hpp"
+namespace TMeCab {
+	const TMeCab::Option options[] = {
+		{"dicdir",             'd'}, // system dicdir
+		{"output",             'o'}, // output file name
+		{nullptr, '\0'}
+	};
+
+	// Numbers the distinct vectors; returns the id of every vector and the first index of each id.
+	std::vector<uint16_t> dedup(const std::vector<std::string> &vecs, std::vector<size_t> &uniq) {
+		std::unordered_map<std::string_view, uint16_t> seen;
+		std::vector<uint16_t> ids;
+		for (size_t i = 0; i < vecs.size(); ++i) {
+			const auto [it, added] = seen.try_emplace(vecs[i], static_cast<uint16_t>(uniq.size()));
+			if (added) uniq.emplace_back(i);
+			ids.emplace_back(it->second);
+		}
+		return ids;
+	}
+	void append(std::string &str, const int16_t v) {
+		str.append(reinterpret_cast<const char *>(&v), sizeof(v));
+	}
+}
+// Writes matrix.bin of dicdir with identical columns and rows merged.
+// Model::open() uses it instead of matrix.bin if named by matrix-dedup and stamped with the current matrix.bin.
+int main(int argc, char **argv) {
+	TMeCab::Param param;
+	if (!param.open(argc, argv, TMeCab::options))
+		return 1;
+	auto dicdir = param.get("dicdir");
+	if (dicdir.empty()) dicdir = "."; // current
+	dicdir += '/';
+	const auto ofilename = param.get("output", dicdir + MATRIX_DEDUP_FILE);
+
+	const auto file = dicdir + MATRIX_FILE;
+	TMeCab::Mmap<int16_t> mmap;
+	if (!mmap.open(file)) return 1;
+	if (mmap.size() <= 2) {
+		std::cerr << "invalid file size: " << file << std::endl;
+		return 1;
+	}
+	const size_t lSize = static_cast<uint16_t>(mmap[0]);
+	const size_t rSize = static_cast<uint16_t>(mmap[1]);
+	if ((lSize * rSize + 2) != mmap.size()) {
+		std::cerr << "invalid file size: " << file << std::endl;
+		return 1;
+	}
+	const int16_t *matrix = mmap.begin() + 2; // matrix[rcAttr + lSize * lcAttr]
+
+	std::vector<std::string> columns(lSize);
+	for (size_t r = 0; r < lSize; ++r)
+		for (size_t l = 0; l < rSize; ++l)
+			TMeCab::append(columns[r], matrix[r + lSize * l]);
+	std::vector<size_t> uniqColumns;
+	const auto column = TMeCab::dedup(columns, uniqColumns);
+	columns.clear();
+
+	std::vector<std::string> rows(rSize);
+	for (size_t l = 0; l < rSize; ++l)
+		for (auto&& r : uniqColumns)
+			TMeCab::append(rows[l], matrix[r + lSize * l]);
+	std::vector<size_t> uniqRows;
+	const auto row = TMeCab::dedup(rows, uniqRows);
+
+	TMeCab::DedupHeader header;
+	header.lSize   = static_cast<int16_t>(lSize);
+	header.rSize   = static_cast<int16_t>(rSize);
+	header.columns = static_cast<int16_t>(uniqColumns.size());
+	header.rows    = static_cast<int16_t>(uniqRows.size());
+	if (!header.stamp(file)) {
+		std::cerr << "failed to get file status: " << file << std::endl;
+		return 1;
+	}
+	std::string out(reinterpret_cast<const char *>(&header), sizeof(header));
+	for (auto&& c : column)
+		TMeCab::append(out, static_cast<int16_t>(c));
+	for (auto&& r : row)
+		TMeCab::append(out, static_cast<int16_t>(r));
+	for (auto&& l : uniqRows)
+		out += rows[l];
+
+	std::ofstream os(ofilename, std::ios::binary);
+	if (!os.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+		std::cerr << "output failed: " << ofilename << std::endl;
+		return 1;
+	}
+	std::cout << file << ": " << lSize << "x" << rSize << " -> "
+		<< uniqColumns.size() << "x" << uniqRows.size() << std::endl;
+	return 0;
+}
+// vim:set ts=2 sts=2 sw=2 noet:
@@ -1,13 +1,17 @@
 // MeCab -- Yet Another Part-of-Speech and Morphological Analyzer
 // Copyright(C) 2001-2011 Taku Kudo <taku@chasen.org>
 // Copyright(C) 2004-2006 Nippon Telegraph and Telephone Corporation
+#include <atomic>
+#include <csignal>
 #include <cstdlib>
 #include <string>
+#include <thread>
 #include <vector>
 #include "tmecab.hpp"
 #include "Param.hpp"
 #include "Stream.hpp"
 #include "Lattice.hpp"
+#include "SlowLog.hpp"
 namespace TMeCab {
 	const TMeCab::Option options[] = {
 		{"rcfile",             'r'}, // resource file
@@ -18,11 +22,26 @@ namespace TMeCab {
 		{"unk-format",         'U'}, // user-defined unknown node format
 		{"bos-format",         'B'}, // user-defined beginning-of-sentence format
 		{"eos-format",         'E'}, // user-defined end-of-sentence format
-		{"eon-format",         'S'}, // user-defined end-of-NBest format(NOT USED)
+		{"eon-format",         'S'}, // user-defined end-of-NBest format
+		{"nbest",              'N'}, // output N best results
 		{"unk-feature",        'x'}, // feature for unknown word
 		{"input-buffer-size",  'b'}, // IGNORED
+		{"boundary-marker",    '\0'}, // forced word boundary, removed from input
+		{"max-nodes",          '\0'}, // per-sentence node limit (0: unlimited)
+		{"max-connects",       '\0'}, // per-sentence connect evaluation limit (0: unlimited)
+		{"max-time",           '\0'}, // per-sentence time limit in microseconds (0: unlimited)
+		{"lookup-cache",       '\0'}, // entries of the dictionary lookup cache (0: disabled)
+		{"lookup-batch",       '\0'}, // positions looked up in one trie walk (1..8, default 1)
+		{"matrix-dedup",       '\0'}, // file of mkmatrix in dicdir, instead of matrix.bin
+		{"extended-char-class", '\0'}, // classify CJK Ext. B+ and emoji like U+4E00 and U+2600
+		{"dump-lattice",       '\0'}, // binary lattice file for bench --replay
+		{"slow-log",           '\0'}, // JSON Lines file of slow sentences
+		{"slow-time",          '\0'}, // slow-log threshold in microseconds
+		{"slow-nodes",         '\0'}, // slow-log threshold in nodes
 		{nullptr, '\0'}
 	};
+	volatile std::sig_atomic_t reloadRequested = 0;
+	extern "C" void requestReload(int) { reloadRequested = 1; }
 }
 int main(int argc, char **argv) {
 	TMeCab::Param param;
@@ -39,8 +58,35 @@ int main(int argc, char **argv) {
 		return 1;
 	}
 
+	const auto nbest = param.getNumber<size_t>("nbest", 1);
+	if (nbest < 1 || nbest > 512) {
+		std::cerr << "nbest size must be 1 <= nbest <= 512\n";
+		return 1;
+	}
+
 	TMeCab::Lattice lattice;
 	if (!lattice.open(param)) return 1;
+	TMeCab::SlowLog slowlog;
+	if (!slowlog.open(param)) return 1;
+	const auto dumpfile = param.get("dump-lattice");
+	std::ofstream dump;
+	if (!dumpfile.empty()) {
+		dump.open(dumpfile, std::ios::binary);
+		if (!dump) {
+			std::cerr << "output failed: " << dumpfile << std::endl;
+			return 1;
+		}
+	}
+	std::string dumpstr;
+	if (dump.is_open()) {
+		TMeCab::DumpHeader().write(dumpstr);
+		dump << dumpstr;
+	}
+	// SIGHUP reloads the dictionaries in the background; lines read meanwhile use the old ones.
+	// A SIGHUP during a reload is kept pending until that reload is done.
+	std::signal(SIGHUP, TMeCab::requestReload);
+	std::atomic<bool> reloading = false;
+	std::jthread reloader;
 
 	auto files = param.restArgs();
 	if (files.empty()) files.push_back("-");
@@ -51,14 +97,40 @@ int main(int argc, char **argv) {
 			std::cerr << "input failed: " << file << std::endl;
 			return 1;
 		}
+		size_t lineno = 0;
 		for (std::string line; std::getline(*is, line);) {
+			++lineno;
+			if (TMeCab::reloadRequested && !reloading) {
+				TMeCab::reloadRequested = 0;
+				reloading = true;
+				reloader = std::jthread([&lattice, &reloading] { // the previous one has finished
+					if (!lattice.reload())
+						std::cerr << "reload failed, keep the current dictionaries\n";
+					reloading = false;
+				});
+			}
+			const auto t0 = slowlog.now();
 			lattice.setSentence(line);
 			lattice.viterbi();
-			if (!lattice.stringify(str)) return 1;
+			if (lattice.isFallback())
+				std::cerr << "budget exceeded, fell back to longest match: " << file << ":" << lineno << std::endl;
+			const auto t1 = slowlog.now();
+			if (!(nbest == 1 ? lattice.stringify(str) : lattice.stringify(str, nbest))) return 1;
+			slowlog.write(line, lattice, t1 - t0, slowlog.now() - t1);
+			if (dump.is_open()) {
+				dumpstr.clear();
+				lattice.dump(dumpstr);
+				dump << dumpstr;
+			}
 			*os << str;
 		}
 		*os << std::flush;
 	}
+	if (const auto &cache = lattice.cache(); cache.isOpen()) {
+		const auto total = cache.hits() + cache.misses();
+		std::cerr << "lookup-cache: " << cache.hits() << " hits / " << total << " lookups ("
+			<< (total ? 100 * cache.hits() / total : 0) << "%)" << std::endl;
+	}
 	return 0;
 }
 // vim:set ts=2 sts=2 sw=2 noet:
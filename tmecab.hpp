@@ -6,11 +6,14 @@
 #define SYS_DIC_FILE       "sys.dic"
 #define UNK_DIC_FILE       "unk.dic"
 #define MATRIX_FILE        "matrix.bin"
+#define MATRIX_DEDUP_FILE  "matrix.dedup" // default output of mkmatrix
 #define CHAR_PROPERTY_FILE "char.bin"
 #define DICRC              "dicrc"
 #define BOS_KEY            "BOS/EOS"
 #define BOS_FEATURE        "BOS/EOS,*,*,*,*,*,*,*,*,*,*,*,*,*,*,*,*"
 #define MAX_GROUPING_SIZE  24
+#define DA_BATCH_SIZE      8
+#define SLOW_LOG_PREFIX    64 // bytes of the input in a slow-log record
 namespace TMeCab {
 	// Parameters for TMeCab::Node::stat
 	enum NodeStat : uint8_t {
@@ -19,14 +22,16 @@ namespace TMeCab {
 		MECAB_BOS_NODE = 2, // Virtual node representing a begin of the sentence.
 		MECAB_EOS_NODE = 3, // Virtual node representing a end of the sentence.
 	};
-	struct Node {
-		struct Node *prev; // pointer to the previous node
-		struct Node *next; // pointer to the next node
+	struct Token;
+	// Cost: type of the accumulative cost. see Lattice
+	template <class Cost> struct BasicNode {
+		struct BasicNode *prev; // pointer to the previous node
+		struct BasicNode *next; // pointer to the next node
 
 		// surface string. this value is not 0 terminated.
 		// You can get the length with length/rlength members.
 		const char *surface;
-		const char *feature; // feature string
+		const Token *token;  // dictionary entry, nullptr for BOS/EOS. see Lattice::feature()
 
 		uint16_t length;  // length of the surface form
 		uint16_t rlength; // length of the surface form including white space before the morph
@@ -34,11 +39,12 @@ namespace TMeCab {
 		uint16_t lcAttr; // left attribute id
 		uint16_t rcAttr; // right attribute id
 
-		int64_t  cost; // best accumulative cost from bos node to this node
+		Cost     cost; // best accumulative cost from bos node to this node
 		int16_t wcost; // word cost
 
 		NodeStat stat; // status of this model.
-		uint8_t _padding[5];
+		uint8_t _padding[sizeof(Cost) - sizeof(int16_t) - sizeof(NodeStat)];
 	};
+	using Node = BasicNode<int64_t>;
 }
 // vim:set ts=2 sts=2 sw=2 noet: